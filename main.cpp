@@ -3,6 +3,20 @@
 #include <map>
 #include <list>
 #include <cfloat>
+#include <fstream>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <filesystem>
+#include <set>
+#include <unordered_map>
 
 using std::string;
 using std::vector;
@@ -13,17 +27,49 @@ using std::cout;
 using std::cin;
 using std::cerr;
 using std::list;
+using std::ostream;
+using std::istream;
 
 using ticket_struct = pair<string, pair<double, int>>;
 using route_struct = vector<pair<pair<int, int>, string>>;
 using tickets_vector = vector<ticket_struct>;
 using timetable_struct = map<int, route_struct>;
+using departure_struct = pair<int, int>;
+using stop_departures_struct = pair<bool, vector<departure_struct>>;
+using departures_struct = pair<std::unordered_map<string, int>,
+        vector<stop_departures_struct>>;
+using task_struct = std::function<void()>;
+using task_queue = pair<std::mutex, std::deque<task_struct>>;
+using record_struct = pair<char, string>;
+using symbols_vector = vector<string>;
+using min_plus_step = void (*)(const double*, double*, int64_t*, int, int,
+        int, double, int64_t);
 
 #define IMPOSSIBLE_RIDE -1
 #define MINUTES_PER_HOUR 60
 #define SIGNALED 1
 #define NOT_SIGNALED 0
 #define CONTINUE_PROCESS 2
+#define TICKETS_LIMIT 3
+#define NO_TICKET -1
+#define NO_PRICE DBL_MAX
+#define NO_STOP -1
+#define BINARY_MAGIC "\x7f" "KB1"
+#define RECORD_HEADER 5
+#define RECORD_CHUNK 65536
+#define RECORD_SYMBOL 'S'
+#define RECORD_TICKET 'T'
+#define RECORD_ROUTE 'R'
+#define RECORD_QUESTION 'Q'
+#define RECORD_LINE 'L'
+#define RECORD_READ 1
+#define RECORD_END 0
+#define RECORD_BROKEN -1
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MIN_PLUS_AVX2
+#endif
 
 
 /**@brief check is the sign a letter
@@ -109,20 +155,21 @@ bool areTramsWorking(int hour, int minute) {
     return !(hour == 21 && minute > 21);
 }
 
-/**@brief select time from text from a given place
+/**@brief select clock time from text from a given place
  * The function select time from text from a given place. Time should
  * has format hh:mm or h:mm, where 'h' means hour cipher and 'm' means
  * minute cipher. If the hour has only one cipher it should be h:mm
- * and if has two ciphers hh:mm.
+ * and if has two ciphers hh:mm (without '0' on the beginning).
+ * It may be any time between 0:00 and 23:59.
  * @param line - text to select from
  * @param start - place where selecting starts
  * @return pair structure, which contains next pair (which contains hour
  * and minute of selected time) and position in text after the end of this
  * information. When input is incorrect return structure ((-1,-1), -1)
  */
-pair<pair<int, int>, int> selectTime(string line, int start) {
+pair<pair<int, int>, int> selectClockTime(string line, int start) {
 
-    if ((int)(line.size()) - start < 5 || !isNumber(line[start]) || line[start] == '0')
+    if ((int)(line.size()) - start < 5 || !isNumber(line[start]))
         return make_pair(make_pair(-1,-1),-1);
 
     int hour, position;
@@ -130,7 +177,8 @@ pair<pair<int, int>, int> selectTime(string line, int start) {
         hour = (int) (line[start]) - (int) ('0');
         position = start + 2;
     }
-    else if (isNumber(line[start + 1]) && line[start+2] == ':') {
+    else if (line[start] != '0' && isNumber(line[start + 1]) &&
+            line[start+2] == ':') {
         hour = ((int)(line[start]) - (int)('0')) * 10 +
                 (int)(line[start + 1]) - (int)('0');
         position = start + 3;
@@ -145,12 +193,32 @@ pair<pair<int, int>, int> selectTime(string line, int start) {
             (int)(line[position + 1]) - (int)('0');
     position += 2;
 
-    if (!areTramsWorking(hour, minute))
+    if (hour > 23 || minute > 59)
         return make_pair(make_pair(-1,-1),-1);
 
     return make_pair(make_pair(hour, minute), position);
 }
 
+/**@brief select time from text from a given place
+ * The function select time in format of @ref selectClockTime from text
+ * from a given place. Trams should be working at this time.
+ * @param line - text to select from
+ * @param start - place where selecting starts
+ * @return pair structure, which contains next pair (which contains hour
+ * and minute of selected time) and position in text after the end of this
+ * information. When input is incorrect return structure ((-1,-1), -1)
+ */
+pair<pair<int, int>, int> selectTime(string line, int start) {
+
+    pair<pair<int, int>, int> time = selectClockTime(line, start);
+
+    if (time.second == -1 ||
+            !areTramsWorking(time.first.first, time.first.second))
+        return make_pair(make_pair(-1,-1),-1);
+
+    return time;
+}
+
 /**@brief select price from text from a given place
  * The function select price with two decimal places (after '.') from text.
  * from a given place.
@@ -263,13 +331,7 @@ bool biggerTime(int hour, int minute, int pHour, int pMinute) {
  */
 bool routeAlreadyExist(int numberOfRoute, timetable_struct* timetable) {
 
-    map<int, vector<pair<pair<int, int>, string> > >::iterator it;
-
-    for (it = timetable->begin(); it != timetable->end(); ++it) {
-        if (it->first == numberOfRoute)
-            return true;
-    }
-    return false;
+    return timetable->count(numberOfRoute) > 0;
 }
 
 /**@brief check has the ticket with given name already exist
@@ -312,16 +374,18 @@ bool tramStopRevisited(string * tramStopName, route_struct* route) {
  * @param prevHour - hour of previous stop
  * @param prevMinute - minute of previous stop
  * @param route - route description
+ * @param err - stream where errors are written
  * @return structure of pair, which contains the next pair (which contains
  * hour and minute of selected time) and tram stop name.
  * When input is incorrect return structure (-1, -1, "")
  */
 pair<pair<int, int>, string> loadTimeAndTramStop(string line, int *start,
-        int numberOfLine, int* prevHour, int* prevMinute, route_struct* route) {
+        int numberOfLine, int* prevHour, int* prevMinute, route_struct* route,
+        ostream* err) {
 
     int position = *start;
     if (line[position] != ' ') {
-        cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
         return make_pair(make_pair(-1, -1), "");
     }
 
@@ -331,7 +395,7 @@ pair<pair<int, int>, string> loadTimeAndTramStop(string line, int *start,
     position = time.second;
     if (hour == -1 || position >= (int)(line.size()) || line[position] != ' ' ||
         !biggerTime(hour, minute, *prevHour, *prevMinute)) {
-        cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
         return make_pair(make_pair(-1, -1), "");
     }
     *prevHour = hour;
@@ -342,27 +406,70 @@ pair<pair<int, int>, string> loadTimeAndTramStop(string line, int *start,
     position = tramStop.second;
 
     if (tramStopName == "empty" || tramStopRevisited(&tramStopName, route)) {
-        cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
         return make_pair(make_pair(-1, -1), "");
     }
     *start = position;
     return make_pair(make_pair(hour, minute), tramStopName);
 }
 
+/**@brief give index of tram stop in departures index
+ * The function gives index of tram stop in departures index, adding the
+ * stop if it is new.
+ * @param tramStopName - tram stop name
+ * @param departures - reference to departures index
+ * @return index of the tram stop
+ */
+int departuresStop(const string& tramStopName, departures_struct* departures) {
+
+    pair<std::unordered_map<string, int>::iterator, bool> stop =
+            departures->first.emplace(tramStopName,
+                    (int)(departures->second.size()));
+    if (stop.second)
+        departures->second.emplace_back();
+    return stop.first->second;
+}
+
+/**@brief add departures of new route to departures index
+ * The function adds departure from every stop of the route except the last
+ * one to the index. Departures of the stop are marked as not sorted, they
+ * are sorted by time and route number when the stop is asked about.
+ * @param numberOfRoute - route number
+ * @param route - route description
+ * @param stops - indexes of route's stops in departures index
+ * @param departures - reference to departures index, which contains map
+ * from tram stop names to their indexes and for every stop pair<sorted,
+ * departures>. Departure pattern: pair<minutes, routeNumber>
+ */
+void addDepartures(int numberOfRoute, route_struct* route, vector<int>* stops,
+        departures_struct* departures) {
+
+    for (size_t i = 0; i + 1 < route->size(); i++) {
+        stop_departures_struct& stopDepartures = departures->second[(*stops)[i]];
+
+        stopDepartures.first = false;
+        stopDepartures.second.emplace_back((*route)[i].first.first *
+                MINUTES_PER_HOUR + (*route)[i].first.second, numberOfRoute);
+    }
+}
+
 /**@brief analyzing the line is it the correct form to add new route
  * The function analyze has the line correct form and if has add new
  * route to timetable.
  * @param line - text with input
  * @param numberOfLine - number of line in input
  * @param timetable - reference to map where the routes are adding
+ * @param departures - reference to departures index
+ * @param err - stream where errors are written
  */
-void loadNewRoute(string line, int numberOfLine, timetable_struct* timetable) {
+void loadNewRoute(string line, int numberOfLine, timetable_struct* timetable,
+        departures_struct* departures, ostream* err) {
 
     pair<int, int> routeNumber = selectNumber(line, 0);
     int numberOfRoute = routeNumber.first, position = routeNumber.second;
 
     if (numberOfRoute == -1 || routeAlreadyExist(numberOfRoute, timetable)) {
-        cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
         return;
     }
 
@@ -372,18 +479,24 @@ void loadNewRoute(string line, int numberOfLine, timetable_struct* timetable) {
     while (position < (int)(line.size())) {
 
         pair<pair<int, int>, string> routeElement = loadTimeAndTramStop(
-                line, &position, numberOfLine, &prevHour, &prevMinute, &route);
+                line, &position, numberOfLine, &prevHour, &prevMinute, &route,
+                err);
         if (routeElement.first.first == -1)
             return;
         route.emplace_back(routeElement);
     }
 
     if (route.empty()) {
-        cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
         return;
     }
 
-    (*timetable)[numberOfRoute] = route;
+    vector<int> stops;
+    for (pair<pair<int, int>, string>& tramStop : route)
+        stops.push_back(departuresStop(tramStop.second, departures));
+
+    addDepartures(numberOfRoute, &route, &stops, departures);
+    (*timetable)[numberOfRoute] = std::move(route);
 }
 
 /**@brief analyzing the line is it the correct form to add new ticket
@@ -392,8 +505,10 @@ void loadNewRoute(string line, int numberOfLine, timetable_struct* timetable) {
  * @param line - text with input
  * @param numberOfLine - number of line in input
  * @param tickets - vector with all tickets
+ * @param err - stream where errors are written
  */
-void loadNewTicket(string line, int numberOfLine, tickets_vector* tickets) {
+void loadNewTicket(string line, int numberOfLine, tickets_vector* tickets,
+        ostream* err) {
 
     pair<string, int> name = selectTicketName(line, 0);
     string ticketName = name.first;
@@ -401,7 +516,7 @@ void loadNewTicket(string line, int numberOfLine, tickets_vector* tickets) {
 
     if (ticketName == "empty" || position >= (int)(line.size()) ||
         line[position] != ' ' || ticketAlreadyExist(&ticketName, tickets)) {
-        cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
         return;
     }
     position++;
@@ -411,7 +526,7 @@ void loadNewTicket(string line, int numberOfLine, tickets_vector* tickets) {
     position = priceResult.second;
 
     if (position >= (int)(line.size()) || line[position] != ' ' || price == -1) {
-        cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
         return;
     }
     position++;
@@ -421,7 +536,7 @@ void loadNewTicket(string line, int numberOfLine, tickets_vector* tickets) {
     position = validity.second;
 
     if (validityTime == -1 || position != (int)(line.size()) || validityTime == 0) {
-        cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
         return;
     }
     tickets->emplace_back(make_pair(ticketName,make_pair(price, validityTime)));
@@ -434,31 +549,33 @@ void loadNewTicket(string line, int numberOfLine, tickets_vector* tickets) {
  * @param question - pointer to list, which will be filled in with input line
  * Fill in pattern: list<pair<stopName, routeNumber>>. On the last element
  * routeNumber equals @p IMPOSSIBLE_RIDE.
- * @return @p SIGNALED if error was signaled on cerr, @p NOT_SIGNALED if the
+ * @param err - stream where errors are written
+ * @return @p SIGNALED if error was signaled on err, @p NOT_SIGNALED if the
  * process was finished without error and @p CONTINUE_PROCESS if everything is
  * ok and line have something more to read
  */
 int isTramStopCorrect(pair<string, int> tramStop, int numberOfLine,
-        string line, list<pair<string, int>>* question, int *start) {
+        string line, list<pair<string, int>>* question, int *start,
+        ostream* err) {
 
     string name = tramStop.first;
     int position = tramStop.second;
 
     if (name == "empty") {
-        cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
         return SIGNALED;
     }
 
     if (position == (int)(line.size()) ) {
         if (question->empty()) {
-            cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+            *err << "Error in line " << numberOfLine << ": " << line << "\n";
             return SIGNALED;
         }
         question->emplace_back(make_pair(name, IMPOSSIBLE_RIDE)); //last element
         return NOT_SIGNALED;
     }
     if (line[position] != ' ' || position == (int)(line.size()) - 1) {
-        cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
         return SIGNALED;
     } else {
         position++;
@@ -473,20 +590,22 @@ int isTramStopCorrect(pair<string, int> tramStop, int numberOfLine,
  * @param question Pointer to list, which will be filled in with input line
  * Fill in pattern: list<pair<stopName, routeNumber>>. On the last element
  * routeNumber equals @p IMPOSSIBLE_RIDE.
- * @return @p true if error was signaled on cerr, @p false otherwise.
+ * @param err Stream where errors are written.
+ * @return @p true if error was signaled on err, @p false otherwise.
  */
 bool loadNewQuestion(string line, int numberOfLine,
-        list<pair<string, int>>* question) {
+        list<pair<string, int>>* question, ostream* err) {
      int position = 2;
 
      if ((int)(line.size()) <= 2 || line[1] != ' ') {
-         cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+         *err << "Error in line " << numberOfLine << ": " << line << "\n";
          return true;
      }
      while (position < (int)(line.size())) {
          pair<string, int> element = selectTramStop(line, position);
 
-         int answer = isTramStopCorrect(element, numberOfLine, line, question, &position);
+         int answer = isTramStopCorrect(element, numberOfLine, line, question,
+                 &position, err);
          if (answer == SIGNALED)
              return true;
          else if (answer == NOT_SIGNALED)
@@ -496,7 +615,7 @@ bool loadNewQuestion(string line, int numberOfLine,
 
          if (route.first == -1 || line[position = route.second] != ' ' ||
                 position >= (int)(line.size()) - 1) {
-             cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+             *err << "Error in line " << numberOfLine << ": " << line << "\n";
              return true;
          } else {
              position++;
@@ -593,182 +712,1364 @@ pair<int, string> rideTime(list<pair<string, int>>* ride,
     return pair<int, string>(duration + 1, "");
 }
 
-/** @brief Counts sum of prices of tickets.
- * @param tickets Vector containing tickets.
- * Ticket representation: <pair<ticket_name, pair<price, validity_time>>>
- * @return Sum of tickets' prices in vector if it contains any ticket.
- * @p DBL_MAX if vector is empty();
- */
-double summaryPrice(tickets_vector* tickets) {
-    if (tickets->empty())
-        return DBL_MAX;
-
-    double sum = 0;
-    for (ticket_struct& ticket : *tickets) {
-        sum += ticket.second.first;
-    }
-    return sum;
-}
-
-/** @brief Function chooses the cheapest set of tickets.
- * @param v1 Pointer to first ticket set.
- * @param v2 Pointer to second ticket set.
- * @param v3 Pointer to third ticket set.
- * @return Pointer to the best set if at least one ticket set is not empty.
- * Empty vector pointer otherwise.
- */
-vector <ticket_struct> * chooseBest(
-        vector <ticket_struct>* v1,
-        vector <ticket_struct>* v2,
-        vector <ticket_struct>* v3) {
-    double price1 = summaryPrice(v1);
-    double price2 = summaryPrice(v2);
-    double price3 = summaryPrice(v3);
-    double minValue = std::min(price1, price2);
-    minValue = std::min(minValue, price3);
-
-    if (minValue == DBL_MAX || minValue == price1)
-        return v1;
-    else if (minValue == price2)
-        return v2;
-    else
-        return v3;
-}
-
-/** @brief Function writing on standart output names of tickets to buy.
+/** @brief Function writing on output names of tickets to buy.
  * If it is impossible to buy tickets, writes ":-|".
  * @param result Pointer to vector with the best tickets set.
  * Empty vector if such set does not exist.
+ * @param out Stream where the result is written.
  */
-size_t displayResult(tickets_vector result) {
+size_t displayResult(tickets_vector result, ostream* out) {
     if (result.empty()) {
-        std::cout << ":-|" << "\n";
+        *out << ":-|" << "\n";
         return 0;
     } else {
-        std::cout << "! ";
+        *out << "! ";
         for (int i = 0; i < (int)(result.size()); i++) {
             if (i != 0)
-                std::cout << "; ";
-            std::cout << result[i].first;
+                *out << "; ";
+            *out << result[i].first;
         }
-        std::cout << "\n";
+        *out << "\n";
         return result.size();
     }
 }
 
 
-/** @brief Modified knapsack problem alghoritm, finds the best set of tickets
- * for given ride time.
- * @param time Demanded ticket validity length.
+/** @brief Scalar step of the min-plus recurrence for tickets combination.
+ * For every duration @p i from [from, to) the cell of current layer is
+ * replaced by cell @p i - validity of previous layer plus price of the
+ * ticket, if such set exists and is not more expensive.
+ * @param previous Prices in the previous layer (one ticket less).
+ * @param current Prices in the current layer.
+ * @param choice Indexes of last tickets in the current layer.
+ * @param from First duration to update.
+ * @param to Duration after the last one to update.
+ * @param validity Validity time of the ticket.
+ * @param price Price of the ticket.
+ * @param ticket Index of the ticket in pricelist.
+ */
+void minPlusScalar(const double* previous, double* current, int64_t* choice,
+        int from, int to, int validity, double price, int64_t ticket) {
+
+    for (int i = from; i < to; i++) {
+        if (previous[i - validity] != NO_PRICE &&
+                previous[i - validity] + price <= current[i]) {
+            current[i] = previous[i - validity] + price;
+            choice[i] = ticket;
+        }
+    }
+}
+
+#ifdef MIN_PLUS_AVX2
+/** @brief AVX2 step of the min-plus recurrence for tickets combination.
+ * Updates four durations at once, the rest is left to @ref minPlusScalar.
+ * Parameters are the same as in @ref minPlusScalar.
+ */
+__attribute__((target("avx2")))
+void minPlusAvx2(const double* previous, double* current, int64_t* choice,
+        int from, int to, int validity, double price, int64_t ticket) {
+
+    const __m256d priceVector = _mm256_set1_pd(price);
+    const __m256d noPrice = _mm256_set1_pd(NO_PRICE);
+    const __m256d ticketVector = _mm256_castsi256_pd(_mm256_set1_epi64x(ticket));
+
+    int i = from;
+    for (; i + 4 <= to; i += 4) {
+        __m256d before = _mm256_loadu_pd(previous + i - validity);
+        __m256d now = _mm256_loadu_pd(current + i);
+        __m256d candidate = _mm256_add_pd(before, priceVector);
+        __m256d better = _mm256_and_pd(
+                _mm256_cmp_pd(before, noPrice, _CMP_NEQ_OQ),
+                _mm256_cmp_pd(candidate, now, _CMP_LE_OQ));
+        __m256d chosen = _mm256_castsi256_pd(
+                _mm256_loadu_si256((const __m256i*)(choice + i)));
+
+        _mm256_storeu_pd(current + i, _mm256_blendv_pd(now, candidate, better));
+        _mm256_storeu_si256((__m256i*)(choice + i), _mm256_castpd_si256(
+                _mm256_blendv_pd(chosen, ticketVector, better)));
+    }
+    minPlusScalar(previous, current, choice, i, to, validity, price, ticket);
+}
+#endif
+
+/** @brief Chooses the min-plus step for the processor, which runs program.
+ * @return Pointer to AVX2 step if processor supports it, scalar step otherwise.
+ */
+min_plus_step selectMinPlusStep() {
+#ifdef MIN_PLUS_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        return minPlusAvx2;
+#endif
+    return minPlusScalar;
+}
+
+/** @brief Modified knapsack problem alghoritm, counts the cheapest sets of
+ * at most @p TICKETS_LIMIT tickets for all durations shorter than given.
+ * Layer @p k keeps sets of exactly k + 1 tickets. Tables have
+ * @p TICKETS_LIMIT layers of @p time cells, cell i is for duration i + 1.
+ * @param time Length of tables.
  * @param tickets Pointer to avaliable tickets, kept in vector.
- * @return Vector with the best set if such exists.
- * Empty vector otherwise.
+ * @param prices Pointer to table, which will be filled with prices of sets,
+ * @p NO_PRICE if the set does not exist.
+ * @param choices Pointer to table, which will be filled with indexes of the
+ * last ticket in sets, @p NO_TICKET if the set does not exist.
  */
-tickets_vector bestSet(int time, tickets_vector* tickets) {
-    //Second table dimension equals 3, because of such tickets amount limitation.
-    tickets_vector optSolution[time][3];
+void fillTicketsTables(int time, tickets_vector* tickets,
+        vector<double>* prices, vector<int64_t>* choices) {
 
-    for (int i = 0; i < time; i++) {
-        for (ticket_struct& ticket : *tickets) {
+    static const min_plus_step step = selectMinPlusStep();
 
-            double price = ticket.second.first;
-            int validity = ticket.second.second;
+    prices->assign((size_t)(TICKETS_LIMIT) * time, NO_PRICE);
+    choices->assign((size_t)(TICKETS_LIMIT) * time, NO_TICKET);
 
+    for (int64_t t = 0; t < (int64_t)(tickets->size()); t++) {
+        double price = (*tickets)[t].second.first;
+        int validity = (*tickets)[t].second.second;
 
-            if (validity >= i + 1 && summaryPrice(&optSolution[i][0]) >= price) {
-                optSolution[i][0].clear();
-                optSolution[i][0].push_back(ticket);
-            }
-            if (i - validity >= 0 && !optSolution[i - validity][0].empty() &&
-                    summaryPrice(&optSolution[i - validity][0]) + price <=
-                    summaryPrice(&optSolution[i][1])) {
-                optSolution[i][1].clear();
-                optSolution[i][1] = optSolution[i - validity][0];
-                optSolution[i][1].push_back(ticket);
-            }
-            if (i - validity >= 0 && !optSolution[i - validity][1].empty() &&
-                    summaryPrice(&optSolution[i - validity][1]) + price <=
-                    summaryPrice(&optSolution[i][2])) {
-                optSolution[i][2].clear();
-                optSolution[i][2] = optSolution[i - validity][1];
-                optSolution[i][2].push_back(ticket);
+        for (int i = 0; i < std::min(validity, time); i++) {
+            if ((*prices)[i] >= price) {
+                (*prices)[i] = price;
+                (*choices)[i] = t;
             }
         }
     }
-    return *chooseBest(&optSolution[time - 1][0], &optSolution[time - 1][1],
-            &optSolution[time - 1][2]);
+    for (int k = 1; k < TICKETS_LIMIT; k++) {
+        const double* previous = prices->data() + (size_t)(k - 1) * time;
+        double* current = prices->data() + (size_t)(k) * time;
+        int64_t* choice = choices->data() + (size_t)(k) * time;
+
+        for (int64_t t = 0; t < (int64_t)(tickets->size()); t++) {
+            int validity = (*tickets)[t].second.second;
+            if (validity < time)
+                step(previous, current, choice, validity, time, validity,
+                        (*tickets)[t].second.first, t);
+        }
+    }
+}
+
+/** @brief Reads the best set of tickets for given ride time from tables
+ * filled by @ref fillTicketsTables.
+ * @param time Demanded ticket validity length, not bigger than @p width.
+ * @param width Length of tables.
+ * @param tickets Pointer to avaliable tickets, kept in vector.
+ * @param prices Pointer to table with prices of sets.
+ * @param choices Pointer to table with indexes of the last ticket in sets.
+ * @return Vector with the best set if such exists.
+ * Empty vector otherwise.
+ */
+tickets_vector readBestSet(int time, int width, tickets_vector* tickets,
+        vector<double>* prices, vector<int64_t>* choices) {
+
+    int layer = 0;
+    for (int k = 1; k < TICKETS_LIMIT; k++) {
+        if ((*prices)[(size_t)(k) * width + time - 1] <
+                (*prices)[(size_t)(layer) * width + time - 1])
+            layer = k;
+    }
+
+    tickets_vector result;
+    int i = time - 1;
+    for (int k = layer; k >= 0; k--) {
+        int64_t choice = (*choices)[(size_t)(k) * width + i];
+        if (choice == NO_TICKET)
+            break;
+        ticket_struct& ticket = (*tickets)[choice];
+        result.push_back(ticket);
+        i -= ticket.second.second;
+    }
+    return tickets_vector(result.rbegin(), result.rend());
+}
+
+/** @brief Finds the best set of tickets for given ride time.
+ * @param time Demanded ticket validity length.
+ * @param tickets Pointer to avaliable tickets, kept in vector.
+ * @return Vector with the best set if such exists.
+ * Empty vector otherwise.
+ */
+tickets_vector bestSet(int time, tickets_vector* tickets) {
+
+    vector<double> prices;
+    vector<int64_t> choices;
+
+    fillTicketsTables(time, tickets, &prices, &choices);
+    return readBestSet(time, time, tickets, &prices, &choices);
 }
 
 /** @brief Inquiry about the best tickets set.
  * @param ride Pointer to list containing ride scheme.
  * @param tickets Pointer to tickets pricelist.
  * @param timetable Pointer to trams timetable.
+ * @param out Stream where the result is written.
  * @return @p true, if result has been displayed.
  * @p false, if not, due to impossible purchase of tickets or
  * ircorrect ride scheme.
  */
 bool ticketsInquiry(list<pair<string, int>>* ride, size_t* ticketsAmount,
         tickets_vector* tickets,
-        timetable_struct* timetable) {
+        timetable_struct* timetable, ostream* out) {
 
     pair<int, string> time = rideTime(ride, timetable);
 
     if (time.first == IMPOSSIBLE_RIDE) {
         if (time.second.length() > 0)
-            cout << ":-( " << time.second << "\n";
+            *out << ":-( " << time.second << "\n";
         else
             return false;
     } else {
-        (*ticketsAmount) += displayResult(bestSet(time.first, tickets));
+        (*ticketsAmount) += displayResult(bestSet(time.first, tickets), out);
     }
     return true;
 }
 
-/** @brief Function which reads whole input and realize all instructions.
+/** @brief Writes time in minutes in text format h:mm or hh:mm. */
+string timeText(uint32_t minutes) {
+
+    uint32_t minute = minutes % MINUTES_PER_HOUR;
+    return std::to_string(minutes / MINUTES_PER_HOUR) +
+            (minute < 10 ? ":0" : ":") + std::to_string(minute);
+}
+
+/** @brief Answers line started with '@' sign. (Departures board line)
+ * Line pattern: "@ stopName time amount". Writes at most @p amount
+ * departures from the stop not earlier than the time, each as route
+ * number, departure time and final stop of the route. The time may be any
+ * time of the day, also when trams are not working.
+ * @param line String containing line of input started with '@'.
+ * @param numberOfLine Number of line, counting started at 1.
  * @param timetable Pointer to trams timetable.
+ * @param departures Pointer to departures index.
+ * @param out Stream where the result is written.
+ * @param err Stream where errors are written.
+ */
+void loadNewBoard(string line, int numberOfLine, timetable_struct* timetable,
+        departures_struct* departures, ostream* out, ostream* err) {
+
+    if ((int)(line.size()) <= 2 || line[1] != ' ') {
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
+        return;
+    }
+    pair<string, int> tramStop = selectTramStop(line, 2);
+    int position = tramStop.second;
+    if (tramStop.first == "empty" || position >= (int)(line.size()) ||
+            line[position] != ' ') {
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
+        return;
+    }
+    pair<pair<int, int>, int> time = selectClockTime(line, position + 1);
+    position = time.second;
+    if (position == -1 || position >= (int)(line.size()) ||
+            line[position] != ' ') {
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
+        return;
+    }
+    pair<int, int> amount = selectValidityTime(line, position + 1);
+    if (amount.first == -1 || amount.second != (int)(line.size())) {
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
+        return;
+    }
+
+    *out << "@";
+    std::unordered_map<string, int>::iterator it =
+            departures->first.find(tramStop.first);
+    if (it != departures->first.end()) {
+        stop_departures_struct& stopDepartures = departures->second[it->second];
+        if (!stopDepartures.first) {
+            std::sort(stopDepartures.second.begin(), stopDepartures.second.end());
+            stopDepartures.first = true;
+        }
+
+        int minutes = time.first.first * MINUTES_PER_HOUR + time.first.second;
+        vector<departure_struct>::iterator departure = std::lower_bound(
+                stopDepartures.second.begin(), stopDepartures.second.end(),
+                make_pair(minutes, INT_MIN));
+
+        for (int i = 0; i < amount.first &&
+                departure != stopDepartures.second.end(); i++, departure++) {
+            *out << (i == 0 ? " " : "; ") << departure->second << " "
+                    << timeText((uint32_t)(departure->first)) << " "
+                    << (*timetable)[departure->second].back().second;
+        }
+    }
+    *out << "\n";
+}
+
+/** @brief Function which realizes single line of text input.
+ * @param line Line of input, not empty.
+ * @param numberOfLine Number of line, counting started at 1.
+ * @param ticketsAmount Pointer to amount of tickets sold so far.
+ * @param out Stream where the results are written.
+ * @param err Stream where the errors are written.
+ * @param timetable Pointer to trams timetable.
+ * @param departures Pointer to departures index.
  * @param tickets Pointer to tickets pricelist.
  */
-void reactOnInput(timetable_struct* timetable,
-              tickets_vector* tickets) {
+void reactOnLine(string line, int numberOfLine, size_t* ticketsAmount,
+        ostream* out, ostream* err, timetable_struct* timetable,
+        departures_struct* departures, tickets_vector* tickets) {
+
+    if (isLetter(line[0]) || line[0] == ' ')
+        loadNewTicket(line, numberOfLine, tickets, err);
+    else if (isNumber(line[0]))
+        loadNewRoute(line, numberOfLine, timetable, departures, err);
+    else if (line[0] == '@')
+        loadNewBoard(line, numberOfLine, timetable, departures, out, err);
+    else if (line[0] == '?') {
+        list<pair<string, int>> question;
+        bool signaled = loadNewQuestion(line, numberOfLine, &question, err);
+
+        if (!signaled) {
+            if (!ticketsInquiry(
+                    &question, ticketsAmount, tickets, timetable, out))
+                *err << "Error in line " << numberOfLine << ": " << line << "\n";
+        }
+    } else
+        *err << "Error in line " << numberOfLine << ": " << line << "\n";
+}
+
+/** @brief Function which reads whole text input and realize all instructions.
+ * @param in Stream with the input.
+ * @param prefix Beginning of the first line, which has been already read.
+ * @param ticketsAmount Pointer to amount of tickets sold so far.
+ * @param out Stream where the results are written.
+ * @param err Stream where the errors are written.
+ * @param timetable Pointer to trams timetable.
+ * @param departures Pointer to departures index.
+ * @param tickets Pointer to tickets pricelist.
+ */
+void reactOnText(istream* in, string prefix, size_t* ticketsAmount,
+        ostream* out, ostream* err, timetable_struct* timetable,
+        departures_struct* departures, tickets_vector* tickets) {
 
     string line;
     int numberOfLine = 1;
+    bool read = (bool)(getline(*in, line)) || !prefix.empty();
+    line = prefix + line;
+
+    while (read) {
+
+        if (!line.empty()) {
+            reactOnLine(line, numberOfLine, ticketsAmount, out, err,
+                    timetable, departures, tickets);
+            numberOfLine ++;
+        }
+        read = (bool)(getline(*in, line));
+    }
+}
+
+/** @brief Checks does the input start with @p BINARY_MAGIC.
+ * Matching characters are taken from the input.
+ * @param in Stream with the input.
+ * @param prefix Pointer to string, which will be filled in with characters
+ * taken from the input.
+ * @return @p true if the input is in binary format, @p false otherwise.
+ */
+bool isBinaryInput(istream* in, string* prefix) {
+
+    for (char sign : string(BINARY_MAGIC)) {
+        if (in->peek() != std::char_traits<char>::to_int_type(sign))
+            return false;
+        prefix->push_back((char)(in->get()));
+    }
+    return true;
+}
+
+/** @brief Reads single record of binary input.
+ * Record consists of its type (one byte), length of its data (four bytes,
+ * little endian) and the data. The data is read in parts of
+ * @p RECORD_CHUNK bytes, so a length bigger than the rest of the input
+ * doesn't allocate memory for it.
+ * @param in Stream with the input.
+ * @param record Pointer to record, which will be filled in.
+ * @return @p RECORD_READ if the record has been read, @p RECORD_END if the
+ * input has ended and @p RECORD_BROKEN if the input ended inside a record.
+ */
+int readRecord(istream* in, record_struct* record) {
+
+    char header[RECORD_HEADER];
+    in->read(header, RECORD_HEADER);
+    if (in->gcount() == 0)
+        return RECORD_END;
+    if (in->gcount() < RECORD_HEADER)
+        return RECORD_BROKEN;
+
+    uint32_t length = 0;
+    for (int i = RECORD_HEADER - 1; i > 0; i--)
+        length = length << 8 | (unsigned char)(header[i]);
+
+    record->first = header[0];
+    record->second.clear();
+
+    char chunk[RECORD_CHUNK];
+    while (record->second.size() < length) {
+        size_t part = std::min<size_t>(RECORD_CHUNK,
+                length - record->second.size());
+        in->read(chunk, (std::streamsize)(part));
+        record->second.append(chunk, (size_t)(in->gcount()));
+        if ((size_t)(in->gcount()) != part)
+            return RECORD_BROKEN;
+    }
+    return RECORD_READ;
+}
+
+/** @brief Takes little endian unsigned number from record data.
+ * @param data Data of the record.
+ * @param position Pointer to position of the number, moved after it.
+ * @param bytes Length of the number in bytes.
+ * @param value Pointer to number, which will be filled in.
+ * @return @p true if the number has been taken, @p false if data is too short.
+ */
+bool takeUnsigned(const string& data, size_t* position, int bytes,
+        uint32_t* value) {
+
+    if (data.size() - *position < (size_t)(bytes))
+        return false;
+
+    *value = 0;
+    for (int i = bytes - 1; i >= 0; i--)
+        *value = *value << 8 | (unsigned char)(data[*position + i]);
+    *position += bytes;
+    return true;
+}
+
+/** @brief Appends little endian unsigned number to record data.
+ * @param data Pointer to data of the record.
+ * @param value Number to append.
+ * @param bytes Length of the number in bytes.
+ */
+void putUnsigned(string* data, uint32_t value, int bytes) {
+
+    for (int i = 0; i < bytes; i++) {
+        data->push_back((char)(value & 0xff));
+        value >>= 8;
+    }
+}
+
+/** @brief Writes single record of binary input.
+ * @param out Stream where the record is written.
+ * @param record Pointer to the record.
+ */
+void writeRecord(ostream* out, record_struct* record) {
+
+    string header(1, record->first);
+    putUnsigned(&header, (uint32_t)(record->second.size()), RECORD_HEADER - 1);
+    out->write(header.data(), (std::streamsize)(header.size()));
+    out->write(record->second.data(), (std::streamsize)(record->second.size()));
+}
+
+/** @brief Reads ticket from data of @p RECORD_TICKET record.
+ * Data: price in cents (4 bytes), validity time (4 bytes), ticket name.
+ * @return @p true if data has correct length, @p false otherwise.
+ */
+bool decodeTicket(const string& data, string* name, uint32_t* cents,
+        uint32_t* validity) {
+
+    size_t position = 0;
+    if (!takeUnsigned(data, &position, 4, cents) ||
+            !takeUnsigned(data, &position, 4, validity))
+        return false;
+
+    *name = data.substr(position);
+    return true;
+}
+
+/** @brief Reads route from data of @p RECORD_ROUTE record.
+ * Data: route number (4 bytes), then for every stop time in minutes
+ * (2 bytes) and symbol of tram stop name (4 bytes).
+ * @return @p true if data has correct length, @p false otherwise.
+ */
+bool decodeRoute(const string& data, uint32_t* numberOfRoute,
+        vector<pair<uint32_t, uint32_t>>* stops) {
+
+    size_t position = 0;
+    if (!takeUnsigned(data, &position, 4, numberOfRoute))
+        return false;
+
+    while (position < data.size()) {
+        uint32_t minutes, symbol;
+        if (!takeUnsigned(data, &position, 2, &minutes) ||
+                !takeUnsigned(data, &position, 4, &symbol))
+            return false;
+        stops->emplace_back(minutes, symbol);
+    }
+    return true;
+}
+
+/** @brief Reads inquiry from data of @p RECORD_QUESTION record.
+ * Data: symbol of the first stop (4 bytes), then for every ride route
+ * number (4 bytes) and symbol of the next stop (4 bytes).
+ * @return @p true if data has correct length, @p false otherwise.
+ */
+bool decodeQuestion(const string& data, vector<uint32_t>* stops,
+        vector<uint32_t>* routes) {
+
+    size_t position = 0;
+    uint32_t symbol, route;
+    if (!takeUnsigned(data, &position, 4, &symbol))
+        return false;
+    stops->push_back(symbol);
+
+    while (position < data.size()) {
+        if (!takeUnsigned(data, &position, 4, &route) ||
+                !takeUnsigned(data, &position, 4, &symbol))
+            return false;
+        routes->push_back(route);
+        stops->push_back(symbol);
+    }
+    return true;
+}
+
+/** @brief Gives name of interned symbol.
+ * @return Name of the symbol, empty string if it has not been defined.
+ */
+string symbolName(symbols_vector* symbols, uint32_t symbol) {
+    return symbol < symbols->size() ? (*symbols)[symbol] : "";
+}
+
+/** @brief Converts price in cents to the same value, which @ref selectPrice
+ * gives for its text.
+ */
+double centsToPrice(uint32_t cents) {
+
+    double price = (double)(cents / 100);
+    price += (double)(cents / 10 % 10) / (double)(10);
+    price += (double)(cents % 10) / (double)(100);
+    return price;
+}
+
+/** @brief Writes price in cents in text format with two decimal places. */
+string priceText(uint32_t cents) {
+    return std::to_string(cents / 100) + "." + std::to_string(cents / 10 % 10) +
+            std::to_string(cents % 10);
+}
+
+/** @brief Writes binary record as a line of text input.
+ * @param record Pointer to the record.
+ * @param symbols Pointer to symbols defined so far.
+ * @return Line of text input, empty if the record is broken.
+ */
+string recordText(record_struct* record, symbols_vector* symbols) {
+
+    string text, name;
+    uint32_t number, validity;
+    vector<pair<uint32_t, uint32_t>> stops;
+    vector<uint32_t> questionStops, routes;
+
+    switch (record->first) {
+        case RECORD_LINE:
+            return record->second;
+        case RECORD_TICKET:
+            if (!decodeTicket(record->second, &name, &number, &validity))
+                return "";
+            return name + " " + priceText(number) + " " +
+                    std::to_string(validity);
+        case RECORD_ROUTE:
+            if (!decodeRoute(record->second, &number, &stops))
+                return "";
+            text = std::to_string(number);
+            for (pair<uint32_t, uint32_t>& stop : stops)
+                text += " " + timeText(stop.first) + " " +
+                        symbolName(symbols, stop.second);
+            return text;
+        case RECORD_QUESTION:
+            if (!decodeQuestion(record->second, &questionStops, &routes))
+                return "";
+            text = "? " + symbolName(symbols, questionStops[0]);
+            for (size_t i = 0; i < routes.size(); i++)
+                text += " " + std::to_string(routes[i]) + " " +
+                        symbolName(symbols, questionStops[i + 1]);
+            return text;
+        default:
+            return "";
+    }
+}
+
+/** @brief Checks can the text be a ticket name.
+ * Name "empty" is not accepted, as in the text format.
+ * @return @p true if the name is not empty and consists of letters and
+ * signs ' ', @p false otherwise
+ */
+bool isTicketName(string name) {
+
+    if (name.empty() || name == "empty")
+        return false;
+    for (char sign : name) {
+        if (!isLetter(sign) && sign != ' ')
+            return false;
+    }
+    return true;
+}
+
+/** @brief Checks can the text be a tram stop name.
+ * Name "empty" is not accepted, as in the text format.
+ * @return @p true if the name is not empty and consists of letters and
+ * signs '_' and '^', @p false otherwise
+ */
+bool isTramStopName(string name) {
+
+    if (name.empty() || name == "empty")
+        return false;
+    for (char sign : name) {
+        if (!isLetter(sign) && sign != '_' && sign != '^')
+            return false;
+    }
+    return true;
+}
+
+/** @brief Adds new ticket from @p RECORD_TICKET record.
+ * Checks the same conditions as @ref loadNewTicket.
+ * @param record Pointer to the record.
+ * @param numberOfLine Number of record in input, not counting symbols.
+ * @param symbols Pointer to symbols defined so far.
+ * @param tickets Pointer to vector with all tickets.
+ * @param err Stream where errors are written.
+ */
+void loadBinaryTicket(record_struct* record, int numberOfLine,
+        symbols_vector* symbols, tickets_vector* tickets, ostream* err) {
+
+    string name;
+    uint32_t cents, validity;
+
+    if (!decodeTicket(record->second, &name, &cents, &validity) ||
+            !isTicketName(name) || validity == 0 || validity > INT_MAX ||
+            ticketAlreadyExist(&name, tickets)) {
+        *err << "Error in line " << numberOfLine << ": "
+                << recordText(record, symbols) << "\n";
+        return;
+    }
+    tickets->emplace_back(make_pair(name,
+            make_pair(centsToPrice(cents), (int)(validity))));
+}
+
+/** @brief Adds new route from @p RECORD_ROUTE record.
+ * Checks the same conditions as @ref loadNewRoute.
+ * @param record Pointer to the record.
+ * @param numberOfLine Number of record in input, not counting symbols.
+ * @param symbols Pointer to symbols defined so far.
+ * @param symbolStops Pointer to indexes of symbols in departures index,
+ * @p NO_STOP if not known yet.
+ * @param timetable Pointer to map where the routes are adding.
+ * @param departures Pointer to departures index.
+ * @param err Stream where errors are written.
+ */
+void loadBinaryRoute(record_struct* record, int numberOfLine,
+        symbols_vector* symbols, vector<int>* symbolStops,
+        timetable_struct* timetable, departures_struct* departures,
+        ostream* err) {
+
+    uint32_t numberOfRoute;
+    vector<pair<uint32_t, uint32_t>> stops;
+    route_struct route;
+
+    bool correct = decodeRoute(record->second, &numberOfRoute, &stops) &&
+            numberOfRoute <= INT_MAX && !stops.empty() &&
+            !routeAlreadyExist((int)(numberOfRoute), timetable);
+    int prevHour = 0, prevMinute = 0;
+
+    for (size_t i = 0; correct && i < stops.size(); i++) {
+        int hour = (int)(stops[i].first / MINUTES_PER_HOUR);
+        int minute = (int)(stops[i].first % MINUTES_PER_HOUR);
+        string tramStopName = symbolName(symbols, stops[i].second);
+
+        correct = areTramsWorking(hour, minute) &&
+                biggerTime(hour, minute, prevHour, prevMinute) &&
+                isTramStopName(tramStopName) &&
+                !tramStopRevisited(&tramStopName, &route);
+        prevHour = hour;
+        prevMinute = minute;
+        route.emplace_back(make_pair(make_pair(hour, minute), tramStopName));
+    }
+
+    if (!correct) {
+        *err << "Error in line " << numberOfLine << ": "
+                << recordText(record, symbols) << "\n";
+        return;
+    }
+    vector<int> routeStops;
+    for (size_t i = 0; i < stops.size(); i++) {
+        int& stop = (*symbolStops)[stops[i].second];
+        if (stop == NO_STOP)
+            stop = departuresStop(route[i].second, departures);
+        routeStops.push_back(stop);
+    }
+
+    addDepartures((int)(numberOfRoute), &route, &routeStops, departures);
+    (*timetable)[(int)(numberOfRoute)] = std::move(route);
+}
+
+/** @brief Reads inquiry from @p RECORD_QUESTION record.
+ * Checks the same conditions as @ref loadNewQuestion.
+ * @param record Pointer to the record.
+ * @param symbols Pointer to symbols defined so far.
+ * @param question Pointer to list, which will be filled in like in
+ * @ref loadNewQuestion.
+ * @return @p true if the inquiry is correct, @p false otherwise.
+ */
+bool readBinaryQuestion(record_struct* record, symbols_vector* symbols,
+        list<pair<string, int>>* question) {
+
+    vector<uint32_t> stops, routes;
+
+    bool correct = decodeQuestion(record->second, &stops, &routes) &&
+            stops.size() > 1;
+
+    for (size_t i = 0; correct && i < stops.size(); i++) {
+        string tramStopName = symbolName(symbols, stops[i]);
+        int route = IMPOSSIBLE_RIDE;
+        if (i < routes.size()) {
+            correct = routes[i] <= INT_MAX;
+            route = (int)(routes[i]);
+        }
+        correct = correct && isTramStopName(tramStopName);
+        question->emplace_back(tramStopName, route);
+    }
+    return correct;
+}
+
+/** @brief Answers inquiry from @p RECORD_QUESTION record.
+ * Checks the same conditions as @ref loadNewQuestion.
+ * @param record Pointer to the record.
+ * @param numberOfLine Number of record in input, not counting symbols.
+ * @param ticketsAmount Pointer to amount of tickets sold so far.
+ * @param symbols Pointer to symbols defined so far.
+ * @param out Stream where the results are written.
+ * @param err Stream where errors are written.
+ * @param timetable Pointer to trams timetable.
+ * @param tickets Pointer to tickets pricelist.
+ */
+void loadBinaryQuestion(record_struct* record, int numberOfLine,
+        size_t* ticketsAmount, symbols_vector* symbols, ostream* out,
+        ostream* err, timetable_struct* timetable, tickets_vector* tickets) {
+
+    list<pair<string, int>> question;
+
+    if (!readBinaryQuestion(record, symbols, &question) ||
+            !ticketsInquiry(&question, ticketsAmount, tickets, timetable, out))
+        *err << "Error in line " << numberOfLine << ": "
+                << recordText(record, symbols) << "\n";
+}
+
+
+/** @brief Function which reads whole binary input and realize all
+ * instructions. Every record except @p RECORD_SYMBOL is counted as one line.
+ * @param in Stream with the input, after @p BINARY_MAGIC.
+ * @param ticketsAmount Pointer to amount of tickets sold so far.
+ * @param out Stream where the results are written.
+ * @param err Stream where the errors are written.
+ * @param timetable Pointer to trams timetable.
+ * @param departures Pointer to departures index.
+ * @param tickets Pointer to tickets pricelist.
+ */
+void reactOnBinary(istream* in, size_t* ticketsAmount, ostream* out,
+        ostream* err, timetable_struct* timetable,
+        departures_struct* departures, tickets_vector* tickets) {
+
+    symbols_vector symbols;
+    vector<int> symbolStops;
+    record_struct record;
+    int numberOfLine = 1;
+    int state;
+
+    while ((state = readRecord(in, &record)) != RECORD_END) {
+
+        if (state == RECORD_BROKEN) {
+            *err << "Error in line " << numberOfLine << ": " << "\n";
+            return;
+        }
+
+        if (record.first == RECORD_SYMBOL) {
+            symbols.push_back(record.second);
+            symbolStops.push_back(NO_STOP);
+            continue;
+        } else if (record.first == RECORD_LINE) {
+            if (record.second.empty())
+                continue;
+            reactOnLine(record.second, numberOfLine, ticketsAmount, out, err,
+                    timetable, departures, tickets);
+        } else if (record.first == RECORD_TICKET)
+            loadBinaryTicket(&record, numberOfLine, &symbols, tickets, err);
+        else if (record.first == RECORD_ROUTE)
+            loadBinaryRoute(&record, numberOfLine, &symbols, &symbolStops,
+                    timetable, departures, err);
+        else if (record.first == RECORD_QUESTION)
+            loadBinaryQuestion(&record, numberOfLine, ticketsAmount, &symbols,
+                    out, err, timetable, tickets);
+        else
+            *err << "Error in line " << numberOfLine << ": " << "\n";
+
+        numberOfLine ++;
+    }
+}
+
+/** @brief Function which reads whole input and realize all instructions.
+ * The input may be in text or in binary format, which starts with
+ * @p BINARY_MAGIC.
+ * @param in Stream with the input.
+ * @param out Stream where the results are written.
+ * @param err Stream where the errors are written.
+ * @param timetable Pointer to trams timetable.
+ * @param departures Pointer to departures index.
+ * @param tickets Pointer to tickets pricelist.
+ */
+void reactOnInput(istream* in, ostream* out, ostream* err,
+              timetable_struct* timetable, departures_struct* departures,
+              tickets_vector* tickets) {
+
+    string prefix;
     size_t ticketsAmount = 0;
 
-    while (getline(cin, line)) {
+    if (isBinaryInput(in, &prefix))
+        reactOnBinary(in, &ticketsAmount, out, err, timetable, departures,
+                tickets);
+    else
+        reactOnText(in, prefix, &ticketsAmount, out, err, timetable, departures,
+                tickets);
+
+    *out << ticketsAmount << "\n";
+}
+
+/** @brief Gives symbol of tram stop name, defining it if it is new.
+ * New symbols are added at the end of @p symbols, their records are
+ * written by the caller.
+ * @param name Tram stop name.
+ * @param interned Pointer to map from names to symbols.
+ * @param symbols Pointer to vector with names of symbols.
+ * @return Symbol of the name.
+ */
+uint32_t internSymbol(string name, map<string, uint32_t>* interned,
+        symbols_vector* symbols) {
+
+    map<string, uint32_t>::iterator it = interned->find(name);
+    if (it != interned->end())
+        return it->second;
+
+    uint32_t symbol = (uint32_t)(symbols->size());
+    (*interned)[name] = symbol;
+    symbols->push_back(name);
+    return symbol;
+}
+
+/** @brief Encodes line of text input as a ticket, route or inquiry record.
+ * Only the form of the line is checked here, other conditions are checked
+ * when the record is read.
+ * @param line Line of text input, not empty.
+ * @param interned Pointer to map from tram stop names to symbols.
+ * @param symbols Pointer to vector with names of symbols.
+ * @param record Pointer to record, which will be filled in.
+ * @return @p true if the line has been encoded, @p false if it has
+ * incorrect form.
+ */
+bool encodeLine(string line, map<string, uint32_t>* interned,
+        symbols_vector* symbols, record_struct* record) {
+
+    int size = (int)(line.size());
+    record->second.clear();
+
+    if (isLetter(line[0]) || line[0] == ' ') {
+        pair<string, int> name = selectTicketName(line, 0);
+        if (name.second == -1 || name.second >= size || line[name.second] != ' ')
+            return false;
+        pair<double, int> price = selectPrice(line, name.second + 1);
+        if (price.second == -1 || price.second >= size ||
+                line[price.second] != ' ')
+            return false;
+        pair<int, int> validity = selectValidityTime(line, price.second + 1);
+        if (validity.first == -1 || validity.second != size ||
+                std::round(price.first * 100) > UINT32_MAX)
+            return false;
+
+        record->first = RECORD_TICKET;
+        putUnsigned(&record->second, (uint32_t)(std::round(price.first * 100)), 4);
+        putUnsigned(&record->second, (uint32_t)(validity.first), 4);
+        record->second += name.first;
+    } else if (isNumber(line[0])) {
+        pair<int, int> routeNumber = selectNumber(line, 0);
+        int position = routeNumber.second;
+
+        record->first = RECORD_ROUTE;
+        putUnsigned(&record->second, (uint32_t)(routeNumber.first), 4);
+        while (position < size) {
+            if (line[position] != ' ')
+                return false;
+            pair<pair<int, int>, int> time = selectTime(line, position + 1);
+            if (time.second == -1 || time.second >= size ||
+                    line[time.second] != ' ')
+                return false;
+            pair<string, int> tramStop = selectTramStop(line, time.second + 1);
+            if (tramStop.second == -1)
+                return false;
+
+            putUnsigned(&record->second, (uint32_t)(time.first.first *
+                    MINUTES_PER_HOUR + time.first.second), 2);
+            putUnsigned(&record->second,
+                    internSymbol(tramStop.first, interned, symbols), 4);
+            position = tramStop.second;
+        }
+    } else if (line[0] == '?') {
+        if (size <= 2 || line[1] != ' ')
+            return false;
+        int position = 2;
+
+        record->first = RECORD_QUESTION;
+        while (true) {
+            pair<string, int> tramStop = selectTramStop(line, position);
+            if (tramStop.second == -1)
+                return false;
+            putUnsigned(&record->second,
+                    internSymbol(tramStop.first, interned, symbols), 4);
+            position = tramStop.second;
+
+            if (position == size)
+                break;
+            if (line[position] != ' ')
+                return false;
+            pair<int, int> route = selectNumber(line, position + 1);
+            if (route.first == -1 || route.second >= size ||
+                    line[route.second] != ' ')
+                return false;
+            putUnsigned(&record->second, (uint32_t)(route.first), 4);
+            position = route.second + 1;
+        }
+    } else
+        return false;
+
+    return true;
+}
+
+/** @brief Converts text input to binary format.
+ * Lines, which can't be written back exactly the same from their records
+ * (also incorrect ones), are kept as @p RECORD_LINE records, so errors are
+ * signaled in the same way for both formats. Records of new symbols are
+ * written only before records, which use them.
+ * @param in Stream with text input.
+ * @param out Stream where binary input is written.
+ * @return @p 0 if the conversion was finished without errors
+ */
+int convertToBinary(istream* in, ostream* out) {
+
+    map<string, uint32_t> interned;
+    symbols_vector symbols;
+    record_struct record;
+    string line;
+
+    out->write(BINARY_MAGIC, (std::streamsize)(string(BINARY_MAGIC).size()));
+    while (getline(*in, line)) {
 
         if (line.empty())
             continue;
-        else if (isLetter(line[0]) || line[0] == ' ')
-            loadNewTicket(line, numberOfLine, tickets);
-        else if (isNumber(line[0]))
-            loadNewRoute(line, numberOfLine, timetable);
-        else if (line[0] == '?') {
-            list<pair<string, int>> question;
-            bool err = loadNewQuestion(line, numberOfLine, &question);
 
-            if (!err) {
-                if (!ticketsInquiry(
-                        &question, &ticketsAmount, tickets, timetable))
-                    cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+        size_t known = symbols.size();
+        if (encodeLine(line, &interned, &symbols, &record) &&
+                recordText(&record, &symbols) == line) {
+            for (size_t i = known; i < symbols.size(); i++) {
+                record_struct symbol = make_pair(RECORD_SYMBOL, symbols[i]);
+                writeRecord(out, &symbol);
             }
-        } else
-            cerr << "Error in line " << numberOfLine << ": " << line << "\n";
+        } else {
+            for (size_t i = known; i < symbols.size(); i++)
+                interned.erase(symbols[i]);
+            symbols.resize(known);
+            record = make_pair(RECORD_LINE, line);
+        }
+        writeRecord(out, &record);
+    }
+    return 0;
+}
 
-        numberOfLine ++;
+/** @brief Converts binary input to text format.
+ * @param in Stream with binary input.
+ * @param out Stream where text input is written.
+ * @return @p 0 if the conversion was finished without errors,
+ * @p 1 if the input is not correct binary input.
+ */
+int convertToText(istream* in, ostream* out) {
+
+    symbols_vector symbols;
+    record_struct record;
+    string prefix;
+    int state;
+
+    if (!isBinaryInput(in, &prefix)) {
+        cerr << "Input is not in binary format\n";
+        return 1;
+    }
+
+    while ((state = readRecord(in, &record)) == RECORD_READ) {
+
+        if (record.first == RECORD_SYMBOL) {
+            symbols.push_back(record.second);
+            continue;
+        }
+        string line = recordText(&record, &symbols);
+        if (line.empty() && record.first != RECORD_LINE) {
+            cerr << "Incorrect record in binary input\n";
+            return 1;
+        }
+        if (!line.empty())
+            *out << line << "\n";
+    }
+
+    if (state == RECORD_BROKEN) {
+        cerr << "Incorrect record in binary input\n";
+        return 1;
+    }
+    return 0;
+}
+
+/** @brief Takes the next task for a worker of the pool.
+ * The worker takes tasks from the back of its own queue first. When its
+ * queue is empty it steals from the front of the other workers' queues.
+ * @param queues Pointer to vector with queues of all workers.
+ * @param worker Index of the worker asking for a task.
+ * @param task Pointer to task, which will be filled in.
+ * @return @p true if a task has been taken, @p false if all queues are empty.
+ */
+bool takeTask(vector<task_queue>* queues, size_t worker, task_struct* task) {
+
+    size_t workers = queues->size();
+    for (size_t k = 0; k < workers; k++) {
+        task_queue& queue = (*queues)[(worker + k) % workers];
+        std::lock_guard<std::mutex> lock(queue.first);
+
+        if (queue.second.empty())
+            continue;
+        if (k == 0) {
+            *task = std::move(queue.second.back());
+            queue.second.pop_back();
+        } else {
+            *task = std::move(queue.second.front());
+            queue.second.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+/** @brief Runs independent tasks on a work-stealing pool of threads.
+ * Tasks are dealt to the workers' queues in turn, then every worker
+ * processes its own queue and steals from the others when it runs dry.
+ * @param tasks Pointer to vector with tasks to run.
+ */
+void runOnPool(vector<task_struct>* tasks) {
+
+    size_t workers = std::thread::hardware_concurrency();
+    workers = std::max<size_t>(1, std::min(workers, tasks->size()));
+
+    vector<task_queue> queues(workers);
+    for (size_t i = 0; i < tasks->size(); i++)
+        queues[i % workers].second.push_back(std::move((*tasks)[i]));
+
+    vector<std::thread> threads;
+    for (size_t worker = 0; worker < workers; worker++) {
+        threads.emplace_back([&queues, worker]() {
+            task_struct task;
+            while (takeTask(&queues, worker, &task))
+                task();
+        });
     }
-    cout << ticketsAmount << "\n";
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+/** @brief Gives the path of output files for input file in batch mode.
+ * It is the name of input file without directories and without @p .in
+ * extension (if it has one), placed in the output directory.
+ * @param directory Output directory.
+ * @param fileName Name of input file.
+ * @return Path of output files without extension.
+ */
+string outputBase(const string& directory, const string& fileName) {
+
+    string base = std::filesystem::path(fileName).filename().string();
+    if (base.size() > 3 && base.compare(base.size() - 3, 3, ".in") == 0)
+        base.erase(base.size() - 3);
+
+    return (std::filesystem::path(directory) / base).string();
+}
+
+/** @brief Gives the path in the form used to compare paths of files.
+ * @param fileName Name of file.
+ * @return Absolute, normalized path of the file.
+ */
+string comparablePath(const string& fileName) {
+    return std::filesystem::absolute(fileName).lexically_normal().string();
+}
+
+/** @brief Processes one input file with its own timetable and tickets.
+ * Results are written to file with @p .out extension and errors to file
+ * with @p .err extension. Output files are created only when the input
+ * file has been opened.
+ * @param fileName Name of input file.
+ * @param base Path of output files without extension.
+ * @return @p true if all files have been opened, @p false otherwise.
+ */
+bool processFile(const string& fileName, const string& base) {
+
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in)
+        return false;
+
+    std::ofstream out(base + ".out");
+    std::ofstream err(base + ".err");
+    if (!out || !err)
+        return false;
+
+    timetable_struct timetable;
+    departures_struct departures;
+    tickets_vector tickets;
+
+    reactOnInput(&in, &out, &err, &timetable, &departures, &tickets);
+    return true;
+}
+
+/** @brief Batch mode, which processes many input files concurrently.
+ * Nothing is processed if two files would have the same output file or
+ * an output file would replace one of input files.
+ * @param arguments Vector with output directory and names of input files.
+ * @return @p 0 if all files have been processed, @p 1 otherwise.
+ */
+int processBatch(vector<string> arguments) {
+
+    if (arguments.size() < 2) {
+        cerr << "Usage: --batch outputDirectory input...\n";
+        return 1;
+    }
+
+    string directory = arguments[0];
+    vector<string> files(arguments.begin() + 1, arguments.end());
+    vector<string> bases;
+    std::set<string> paths;
+
+    for (string& fileName : files)
+        paths.insert(comparablePath(fileName));
+    for (string& fileName : files) {
+        bases.push_back(outputBase(directory, fileName));
+        if (!paths.insert(comparablePath(bases.back() + ".out")).second ||
+                !paths.insert(comparablePath(bases.back() + ".err")).second) {
+            cerr << "Output files of " << fileName << " are not unique\n";
+            return 1;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        cerr << "Cannot create directory: " << directory << "\n";
+        return 1;
+    }
+
+    vector<task_struct> tasks;
+    vector<char> processed(files.size(), 0);
+
+    for (size_t i = 0; i < files.size(); i++) {
+        tasks.emplace_back([&files, &bases, &processed, i]() {
+            processed[i] = processFile(files[i], bases[i]);
+        });
+    }
+    runOnPool(&tasks);
+
+    int result = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!processed[i]) {
+            cerr << "Cannot process file: " << files[i] << "\n";
+            result = 1;
+        }
+    }
+    return result;
+}
+
+/** @brief Counts ride of recorded inquiry, if the inquiry is correct.
+ * @param question Pointer to list with the inquiry.
+ * @param timetable Pointer to trams timetable.
+ * @param durations Pointer to map with amounts of rides of every duration.
+ */
+void countRide(list<pair<string, int>>* question, timetable_struct* timetable,
+        map<int, size_t>* durations) {
+
+    int time = rideTime(question, timetable).first;
+    if (time != IMPOSSIBLE_RIDE)
+        (*durations)[time]++;
+}
+
+/** @brief Counts ride of line of the query log, if it is a correct inquiry.
+ * @param line Line of the query log.
+ * @param timetable Pointer to trams timetable.
+ * @param durations Pointer to map with amounts of rides of every duration.
+ */
+void countQueryLine(string line, timetable_struct* timetable,
+        map<int, size_t>* durations) {
+
+    std::ostream discard(nullptr);
+    list<pair<string, int>> question;
+
+    if (!line.empty() && line[0] == '?' &&
+            !loadNewQuestion(line, 0, &question, &discard))
+        countRide(&question, timetable, durations);
+}
+
+/** @brief Reads recorded inquiries and counts how many rides of every
+ * duration they describe. Other lines and incorrect inquiries are skipped.
+ * @param in Stream with the query log in text or binary format.
+ * @param timetable Pointer to trams timetable.
+ * @param durations Pointer to map, which will be filled in with amounts of
+ * rides of every duration.
+ * @return @p true if the log has been read, @p false if binary log ended
+ * inside a record.
+ */
+bool loadQueryLog(istream* in, timetable_struct* timetable,
+        map<int, size_t>* durations) {
+
+    string prefix, line;
+
+    if (isBinaryInput(in, &prefix)) {
+        symbols_vector symbols;
+        record_struct record;
+        int state;
+
+        while ((state = readRecord(in, &record)) == RECORD_READ) {
+            list<pair<string, int>> question;
+
+            if (record.first == RECORD_SYMBOL)
+                symbols.push_back(record.second);
+            else if (record.first == RECORD_LINE)
+                countQueryLine(record.second, timetable, durations);
+            else if (record.first == RECORD_QUESTION &&
+                    readBinaryQuestion(&record, &symbols, &question))
+                countRide(&question, timetable, durations);
+        }
+        return state == RECORD_END;
+    }
+
+    bool read = (bool)(getline(*in, line)) || !prefix.empty();
+    line = prefix + line;
+    while (read) {
+        countQueryLine(line, timetable, durations);
+        read = (bool)(getline(*in, line));
+    }
+    return true;
+}
+
+/** @brief Counts tickets sold and revenue for recorded rides with given
+ * pricelist. Tables of the best sets are filled once for the longest ride.
+ * @param durations Pointer to map with amounts of rides of every duration.
+ * @param tickets Pointer to tickets pricelist.
+ * @return Pair structure with amount of tickets sold and revenue.
+ */
+pair<size_t, double> replayTickets(map<int, size_t>* durations,
+        tickets_vector* tickets) {
+
+    if (durations->empty())
+        return make_pair(0, 0);
+
+    vector<double> prices;
+    vector<int64_t> choices;
+    int width = durations->rbegin()->first;
+    size_t ticketsAmount = 0;
+    double revenue = 0;
+
+    fillTicketsTables(width, tickets, &prices, &choices);
+    for (pair<const int, size_t>& duration : *durations) {
+        tickets_vector result = readBestSet(duration.first, width, tickets,
+                &prices, &choices);
+        for (ticket_struct& ticket : result)
+            revenue += ticket.second.first * (double)(duration.second);
+        ticketsAmount += result.size() * duration.second;
+    }
+    return make_pair(ticketsAmount, revenue);
+}
+
+/** @brief Replay mode, which counts tickets sold and revenue for recorded
+ * inquiries with every of candidate pricelists. Durations of rides are
+ * counted once and pricelists are evaluated concurrently.
+ * Writes line "fileName ticketsAmount revenue" for every pricelist.
+ * @param files Vector with names of files: timetable, query log and
+ * candidate pricelists. All of them may be in text or binary format.
+ * Errors of timetable and pricelists are written on cerr after the name
+ * of the file.
+ * @return @p 0 if all files have been processed, @p 1 otherwise.
+ */
+int processReplay(vector<string> files) {
+
+    if (files.size() < 3) {
+        cerr << "Usage: --replay timetable queries pricelist...\n";
+        return 1;
+    }
+
+    std::ostream discard(nullptr);
+    timetable_struct timetable;
+    departures_struct departures;
+    tickets_vector timetableTickets;
+    vector<tickets_vector> pricelists(files.size() - 2);
+    map<int, size_t> durations;
+
+    for (size_t i = 0; i < files.size(); i++) {
+        std::ifstream in(files[i], std::ios::binary);
+        std::ostringstream err;
+        if (!in) {
+            cerr << "Cannot process file: " << files[i] << "\n";
+            return 1;
+        }
+        if (i == 0)
+            reactOnInput(&in, &discard, &err, &timetable, &departures,
+                    &timetableTickets);
+        else if (i == 1 && !loadQueryLog(&in, &timetable, &durations)) {
+            cerr << files[i] << ": Incorrect record in binary input\n";
+            return 1;
+        } else if (i > 1) {
+            timetable_struct ignoredTimetable;
+            departures_struct ignoredDepartures;
+            reactOnInput(&in, &discard, &err, &ignoredTimetable,
+                    &ignoredDepartures, &pricelists[i - 2]);
+        }
+
+        std::istringstream errors(err.str());
+        string error;
+        while (getline(errors, error))
+            cerr << files[i] << ": " << error << "\n";
+    }
+
+    vector<task_struct> tasks;
+    vector<pair<size_t, double>> results(pricelists.size());
+
+    for (size_t i = 0; i < pricelists.size(); i++) {
+        tasks.emplace_back([&durations, &pricelists, &results, i]() {
+            results[i] = replayTickets(&durations, &pricelists[i]);
+        });
+    }
+    runOnPool(&tasks);
+
+    for (size_t i = 0; i < results.size(); i++) {
+        cout << files[i + 2] << " " << results[i].first << " "
+                << std::fixed << std::setprecision(2) << results[i].second
+                << "\n";
+    }
+    return 0;
 }
 
 /**@brief main function, which begin the whole process
+ * Without arguments reads standard input. With @p --batch followed by
+ * output directory and names of input files processes each of them
+ * independently.
+ * With @p --to-binary or @p --to-text converts standard input to the
+ * other format. With @p --replay followed by names of timetable, query log
+ * and pricelists compares the pricelists on recorded inquiries.
  * @return @p 0 if the program was finished without errors
  */
-int main() {
+int main(int argc, char* argv[]) {
+
+    if (argc > 1 && string(argv[1]) == "--batch")
+        return processBatch(vector<string>(argv + 2, argv + argc));
+    if (argc > 1 && string(argv[1]) == "--to-binary")
+        return convertToBinary(&cin, &cout);
+    if (argc > 1 && string(argv[1]) == "--to-text")
+        return convertToText(&cin, &cout);
+    if (argc > 1 && string(argv[1]) == "--replay")
+        return processReplay(vector<string>(argv + 2, argv + argc));
 
     timetable_struct timetable;
+    departures_struct departures;
     tickets_vector tickets;
 
-    reactOnInput(&timetable, &tickets);
+    reactOnInput(&cin, &cout, &cerr, &timetable, &departures, &tickets);
 
     return 0;
 }
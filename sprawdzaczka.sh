@@ -1,4 +1,4 @@
-g++ -Wall -Wextra -O2 -std=c++17 main.cpp -o kasa
+g++ -Wall -Wextra -O2 -std=c++17 -pthread main.cpp -o kasa
 
 test="przyklad"
 